@@ -7,6 +7,7 @@
 
 import Foundation
 import RealmSwift
+import os
 
 protocol WeatherDatabaseProtocol {
     func fetchWeather(for city: String) -> Weather?
@@ -14,30 +15,117 @@ protocol WeatherDatabaseProtocol {
 }
 
 class RealmWeatherDatabase: WeatherDatabaseProtocol {
-    private let realm = try! Realm()
+    static let configuration = Realm.Configuration(
+        schemaVersion: 3,
+        migrationBlock: { migration, oldSchemaVersion in
+            if oldSchemaVersion < 1 {
+                // dateFetched changed from a localized String to a Date; the old text isn't reliably parseable
+                migration.enumerateObjects(ofType: WeatherRealmModel.className()) { _, newObject in
+                    newObject?["dateFetched"] = Date.distantPast
+                }
+            }
+            if oldSchemaVersion < 2 {
+                // cityName became a normalized lookup key; old rows may collide once folded, and the cache refills cheaply
+                migration.deleteData(forType: WeatherRealmModel.className())
+            }
+            if oldSchemaVersion < 3 {
+                // Forecast types became embedded; earlier saves left orphaned rows and days shared
+                // between cities (date was the primary key), which can't be converted, so start clean
+                migration.deleteData(forType: WeatherRealmModel.className())
+                migration.deleteData(forType: CurrentRealmModel.className())
+                migration.deleteData(forType: ForecastRealmModel.className())
+                migration.deleteData(forType: ForecastDayRealmModel.className())
+            }
+        },
+        shouldCompactOnLaunch: { totalBytes, usedBytes in
+            // Every save replaces a city's whole forecast, so freed pages and old history build
+            // up; reclaim them once the file is past 10 MB and less than half of it is live data
+            let tenMB = 10 * 1024 * 1024
+            let shouldCompact = totalBytes > tenMB && Double(usedBytes) / Double(totalBytes) < 0.5
+            if shouldCompact {
+                print("Compacting weather cache: \(usedBytes) of \(totalBytes) bytes in use")
+            }
+            return shouldCompact
+        },
+        // Listing the classes up front skips scanning the whole Objective-C runtime for
+        // Object subclasses when the first Realm is opened
+        objectTypes: [
+            WeatherRealmModel.self,
+            CurrentRealmModel.self,
+            ConditionRealmModel.self,
+            ForecastRealmModel.self,
+            ForecastDayRealmModel.self
+        ]
+    )
+    
+    // Opened on first use so launch doesn't wait on migration or compaction
+    private lazy var realm = try! Realm(configuration: RealmWeatherDatabase.configuration)
+    // Serial queue so saving a full forecast never blocks the main thread. Draining the
+    // autorelease pool per work item releases the queue's Realm after each flush, so it
+    // never pins an old version that later reads would have to advance across.
+    private let writeQueue = DispatchQueue(label: "com.test.WeatherForecastingApp.realmWrite", qos: .utility, autoreleaseFrequency: .workItem)
+    // Intervals show up in Instruments' os_signpost track for latency analysis
+    private let signposter = OSSignposter(subsystem: "com.test.WeatherForecastingApp", category: "Realm")
+    // Saves waiting for the next write transaction; only touched on writeQueue
+    private var pendingSaves: [(weather: Weather, city: String, state: OSSignpostIntervalState)] = []
+    // Immutable decoded forecasts shared by every fetch of the same city until it is saved
+    // again; like `realm`, only touched on the main thread
+    private var snapshots: [String: Weather] = [:]
+    
+    init() {
+        // Run any pending migration and compaction in the background at startup; by the time
+        // the first fetch opens the main-thread Realm the file is already at the current schema
+        writeQueue.async {
+            do {
+                _ = try Realm(configuration: RealmWeatherDatabase.configuration)
+            } catch {
+                print("Failed to open weather cache: \(error.localizedDescription)")
+            }
+        }
+    }
     
     func fetchWeather(for city: String) -> Weather? {
-        let results = realm.objects(WeatherRealmModel.self).filter("cityName == %@", city)
+        let state = signposter.beginInterval("FetchCachedWeather", id: signposter.makeSignpostID(), "\(city, privacy: .public)")
+        defer { signposter.endInterval("FetchCachedWeather", state) }
+        
+        let cityKey = RealmWeatherDatabase.cityKey(for: city)
+        if let snapshot = snapshots[cityKey] {
+            return snapshot
+        }
         
-        if let entity = results.first {
-            var currentCondition: Condition? = nil
-            if let condition = entity.current?.condition {
-                currentCondition = Condition(text: condition.text, icon: condition.icon, code: condition.code)
+        // Exact primary-key lookup on the normalized name instead of a string query
+        if let entity = realm.object(ofType: WeatherRealmModel.self, forPrimaryKey: cityKey) {
+            // Each link/property read goes back through the Realm accessor, so resolve every
+            // link once and decode each distinct condition row (keyed by code) only once
+            var conditions: [Int: Condition] = [:]
+            func decodedCondition(_ entity: ConditionRealmModel) -> Condition {
+                let code = entity.code
+                if let condition = conditions[code] {
+                    return condition
+                }
+                let condition = Condition(text: entity.text, icon: entity.icon, code: code)
+                conditions[code] = condition
+                return condition
             }
             
+            let current = entity.current
             let currentWeather = Current(
-                temp_c: entity.current?.temperatureC,
-                condition: currentCondition,
-                wind_mph: entity.current?.windMph,
-                wind_kph: entity.current?.windKph,
-                humidity: entity.current?.humidity
+                temp_c: current?.temperatureC,
+                condition: (current?.condition).map(decodedCondition),
+                wind_mph: current?.windMph,
+                wind_kph: current?.windKph,
+                humidity: current?.humidity
             )
             
+            let forecastDayEntities = entity.forecast?.forecastDays ?? List<ForecastDayRealmModel>()
             var forecastDays: [Forecastday] = []
-            for forecastDay in entity.forecast?.forecastDays ?? List<ForecastDayRealmModel>() {
+            forecastDays.reserveCapacity(forecastDayEntities.count)
+            for forecastDay in forecastDayEntities {
+                let hourEntities = forecastDay.hours
                 var hours: [Current] = []
-                for hour in forecastDay.hours {
-                    let hourCondition = Condition(text: hour.condition?.text ?? "", icon: hour.condition?.icon ?? "", code: hour.condition?.code ?? 0)
+                hours.reserveCapacity(hourEntities.count)
+                for hour in hourEntities {
+                    let hourCondition = hour.condition.map(decodedCondition) ?? Condition(text: "", icon: "", code: 0)
                     let hourData = Current(
                         temp_c: hour.temperatureC,
                         condition: hourCondition,
@@ -59,20 +147,85 @@ class RealmWeatherDatabase: WeatherDatabaseProtocol {
             let forecast = Forecast(forecastday: forecastDays)
             
             let weather = Weather(
-                location: Location(name: entity.cityName),
+                location: Location(name: entity.locationName),
                 current: currentWeather,
                 forecast: forecast
             )
             
+            snapshots[cityKey] = weather
             return weather
         }
         return nil
     }
     
     func saveWeather(_ weather: Weather, for city: String) {
+        // Covers time spent waiting on the write queue as well as the write itself
+        let state = signposter.beginInterval("SaveWeather", id: signposter.makeSignpostID(), "\(city, privacy: .public)")
+        snapshots.removeValue(forKey: RealmWeatherDatabase.cityKey(for: city))
+        writeQueue.async {
+            self.pendingSaves.append((weather, city, state))
+            // The first pending save schedules a flush; saves arriving before it runs share its transaction
+            if self.pendingSaves.count == 1 {
+                self.writeQueue.async {
+                    self.flushPendingSaves()
+                }
+            }
+        }
+    }
+    
+    // "London", "london " and "LONDON" should all hit the same cached row
+    private static func cityKey(for city: String) -> String {
+        return city.trimmingCharacters(in: .whitespacesAndNewlines).lowercased()
+    }
+    
+    private func flushPendingSaves() {
+        let saves = pendingSaves
+        pendingSaves.removeAll()
+        
+        var conditionEntities: [Int: ConditionRealmModel] = [:]
+        let weatherEntities = saves.map { makeWeatherEntity($0.weather, for: $0.city, conditionEntities: &conditionEntities) }
+        
+        do {
+            // Realm instances are thread-confined, so open one for the write queue
+            let realm = try Realm(configuration: RealmWeatherDatabase.configuration)
+            try realm.write {
+                realm.add(weatherEntities, update: .modified)
+            }
+        } catch {
+            print("Failed to save weather: \(error.localizedDescription)")
+        }
+        
+        DispatchQueue.main.async {
+            // Bring the main-thread Realm up to this commit before dropping the snapshots, so a
+            // fetch in between can't re-cache the pre-save forecast
+            self.realm.refresh()
+            for save in saves {
+                self.snapshots.removeValue(forKey: RealmWeatherDatabase.cityKey(for: save.city))
+            }
+        }
+        
+        for save in saves {
+            signposter.endInterval("SaveWeather", save.state)
+        }
+    }
+    
+    private func makeWeatherEntity(_ weather: Weather, for city: String, conditionEntities: inout [Int: ConditionRealmModel]) -> WeatherRealmModel {
         let weatherEntity = WeatherRealmModel()
-        weatherEntity.cityName = city
-        weatherEntity.dateFetched = DateFormatter.localizedString(from: Date(), dateStyle: .short, timeStyle: .short)
+        weatherEntity.cityName = RealmWeatherDatabase.cityKey(for: city)
+        weatherEntity.locationName = weather.location?.name ?? city
+        weatherEntity.dateFetched = Date()
+        
+        // Condition text/icon repeat across nearly all 120 hourly rows, so share one
+        // entity per code and let the write upsert each distinct condition only once
+        func conditionEntity(for condition: Condition) -> ConditionRealmModel {
+            let code = condition.code ?? 0
+            let entity = conditionEntities[code] ?? ConditionRealmModel()
+            entity.code = code
+            entity.text = condition.text ?? ""
+            entity.icon = condition.icon ?? ""
+            conditionEntities[code] = entity
+            return entity
+        }
         
         if let current = weather.current {
             let currentEntity = CurrentRealmModel()
@@ -82,12 +235,7 @@ class RealmWeatherDatabase: WeatherDatabaseProtocol {
             currentEntity.windKph = current.wind_kph ?? 0.0
             
             if let condition = current.condition {
-                let conditionEntity = ConditionRealmModel()
-                conditionEntity.text = condition.text ?? ""
-                conditionEntity.icon = condition.icon ?? ""
-                conditionEntity.code = condition.code ?? 0
-                
-                currentEntity.condition = conditionEntity
+                currentEntity.condition = conditionEntity(for: condition)
             }
             
             weatherEntity.current = currentEntity
@@ -108,12 +256,7 @@ class RealmWeatherDatabase: WeatherDatabaseProtocol {
                     hourEntity.windKph = hour.wind_kph ?? 0.0
                     
                     if let condition = hour.condition {
-                        let hourConditionEntity = ConditionRealmModel()
-                        hourConditionEntity.text = condition.text ?? ""
-                        hourConditionEntity.icon = condition.icon ?? ""
-                        hourConditionEntity.code = condition.code ?? 0
-                        
-                        hourEntity.condition = hourConditionEntity
+                        hourEntity.condition = conditionEntity(for: condition)
                     }
                     
                     forecastDayEntity.hours.append(hourEntity)
@@ -125,12 +268,6 @@ class RealmWeatherDatabase: WeatherDatabaseProtocol {
         
         weatherEntity.forecast = forecastEntity
         
-        do {
-            try realm.write {
-                realm.add(weatherEntity, update: .modified)
-            }
-        } catch {
-            print("Failed to save weather: \(error.localizedDescription)")
-        }
+        return weatherEntity
     }
 }
@@ -9,8 +9,9 @@ import Foundation
 import RealmSwift
 
 class WeatherRealmModel: Object {
-    @objc dynamic var cityName: String = ""
-    @objc dynamic var dateFetched: String = ""
+    @objc dynamic var cityName: String = "" // Trimmed, lowercased lookup key
+    @objc dynamic var locationName: String = "" // Display name as returned by the API
+    @objc dynamic var dateFetched: Date = Date() // Stored as a native timestamp rather than formatted text
     @objc dynamic var current: CurrentRealmModel? // Embed CurrentRealmModel
     @objc dynamic var forecast: ForecastRealmModel?
     
@@ -19,7 +20,9 @@ class WeatherRealmModel: Object {
     }
 }
 
-class CurrentRealmModel: Object {
+// Embedded types are owned by their parent: no primary-key index, and they are deleted
+// together with the parent instead of being left orphaned every time a city is re-saved
+class CurrentRealmModel: EmbeddedObject {
     @objc dynamic var temperatureC: Double = 0.0
     @objc dynamic var windMph: Double = 0.0
     @objc dynamic var windKph: Double = 0.0
@@ -38,17 +41,13 @@ class ConditionRealmModel: Object {
 }
 
 // Forecast Realm Model
-class ForecastRealmModel: Object {
+class ForecastRealmModel: EmbeddedObject {
     let forecastDays = List<ForecastDayRealmModel>() // List of forecast days
 }
 
 // Forecast Day Realm Model
-class ForecastDayRealmModel: Object {
+class ForecastDayRealmModel: EmbeddedObject {
     @objc dynamic var date: String = ""
     @objc dynamic var dateEpoch: Int = 0
     let hours = List<CurrentRealmModel>() // List of hours with current weather data
-
-    override static func primaryKey() -> String? {
-        return "date" // Use date as the primary key (or another suitable identifier)
-    }
 }
@@ -8,6 +8,7 @@
 import Foundation
 import Combine
 import RealmSwift
+import os
 
 class WeatherViewModel: ObservableObject {
     @Published var weather: Weather?
@@ -16,6 +17,7 @@ class WeatherViewModel: ObservableObject {
     private var weatherService: WeatherServiceProtocol
     private var weatherDatabase: WeatherDatabaseProtocol
     private var currentCity: String?
+    private let signposter = OSSignposter(subsystem: "com.test.WeatherForecastingApp", category: "Weather")
 
     // Inject dependencies
     init(weatherService: WeatherServiceProtocol = WeatherService(),
@@ -32,11 +34,14 @@ class WeatherViewModel: ObservableObject {
         currentCity = city
         
         if let cachedWeather = weatherDatabase.fetchWeather(for: city) {
+            signposter.emitEvent("CacheHit", "\(city, privacy: .public)")
             self.weather = cachedWeather
             return
         }
         
+        let requestState = signposter.beginInterval("NetworkFetch", id: signposter.makeSignpostID(), "\(city, privacy: .public)")
         weatherService.getWeather(for: city) { [weak self] result in
+            self?.signposter.endInterval("NetworkFetch", requestState)
             switch result {
             case .success(let response):
                 self?.weather = response